@@ -0,0 +1,189 @@
+#pragma once
+
+#include "../shared_and_weak/shared.h"
+#include "../intrusive/intrusive.h"
+
+#include <cassert>
+#include <cstddef>  // std::max_align_t
+#include <cstring>  // std::memcpy, std::memset
+#include <memory>   // std::align
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for objects that all die together (e.g. at the end of a request).
+// Objects are still destroyed one by one when their last owner goes away, but their
+// memory is only given back by `Reset()` or the destructor.
+//
+// In debug builds (no NDEBUG) every object created through `Create` is counted, and
+// `Reset()`/`~Arena()` assert that none of them is still alive.
+class Arena {
+public:
+    static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+    explicit Arena(size_t chunk_size = kDefaultChunkSize) : chunk_size_(chunk_size) {
+    }
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena() {
+        Reset();
+        for (auto& chunk : chunks_) {
+            ::operator delete(chunk.data);
+        }
+    }
+
+    // Raw memory, not tracked.
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        void* ptr = cursor_;
+        size_t space = end_ - cursor_;
+        if (!cursor_ || !std::align(alignment, size, ptr, space)) {
+            NextChunk(size + alignment);
+            ptr = cursor_;
+            space = end_ - cursor_;
+            std::align(alignment, size, ptr, space);
+        }
+        cursor_ = static_cast<char*>(ptr) + size;
+        return ptr;
+    }
+
+    // Construct `T` in arena memory. The object must later be finished with `Forget`
+    // instead of `delete`.
+    template <typename T, typename... Args>
+    T* Create(Args&&... args) {
+        void* memory = AllocateObject(sizeof(T), alignof(T));
+        T* object = new (memory) T(std::forward<Args>(args)...);
+        Register(object);
+        return object;
+    }
+
+    // Mark an object returned by `Create` as dead. Memory is not reclaimed.
+    static void Forget([[maybe_unused]] void* object) {
+#ifndef NDEBUG
+        Arena* arena;
+        std::memcpy(&arena, static_cast<char*>(object) - kHeaderSize, kHeaderSize);
+        assert(arena->live_ > 0);
+        --arena->live_;
+#endif
+    }
+
+    // Release every allocation at once. Chunks are kept for the next round.
+    void Reset() {
+#ifndef NDEBUG
+        assert(live_ == 0 && "Arena reset while arena-owned objects are still referenced");
+        for (auto& chunk : chunks_) {
+            std::memset(chunk.data, 0xdd, chunk.size);
+        }
+#endif
+        next_chunk_ = 0;
+        cursor_ = nullptr;
+        end_ = nullptr;
+    }
+
+#ifndef NDEBUG
+    size_t LiveCount() const {
+        return live_;
+    }
+#endif
+
+private:
+    struct Chunk {
+        char* data;
+        size_t size;
+    };
+
+    void NextChunk(size_t min_size) {
+        while (next_chunk_ < chunks_.size() && chunks_[next_chunk_].size < min_size) {
+            ++next_chunk_;
+        }
+        if (next_chunk_ == chunks_.size()) {
+            size_t size = min_size > chunk_size_ ? min_size : chunk_size_;
+            chunks_.push_back({static_cast<char*>(::operator new(size)), size});
+        }
+        cursor_ = chunks_[next_chunk_].data;
+        end_ = cursor_ + chunks_[next_chunk_].size;
+        ++next_chunk_;
+    }
+
+#ifndef NDEBUG
+    // Debug builds keep the owning arena right before each tracked object.
+    static constexpr size_t kHeaderSize = sizeof(Arena*);
+
+    void* AllocateObject(size_t size, size_t alignment) {
+        size_t offset = (kHeaderSize + alignment - 1) / alignment * alignment;
+        return static_cast<char*>(Allocate(offset + size, alignment)) + offset;
+    }
+    void Register(void* object) {
+        Arena* self = this;
+        std::memcpy(static_cast<char*>(object) - kHeaderSize, &self, kHeaderSize);
+        ++live_;
+    }
+
+    size_t live_ = 0;
+#else
+    void* AllocateObject(size_t size, size_t alignment) {
+        return Allocate(size, alignment);
+    }
+    void Register(void*) {
+    }
+#endif
+
+    size_t chunk_size_;
+    std::vector<Chunk> chunks_;
+    size_t next_chunk_ = 0;
+    char* cursor_ = nullptr;
+    char* end_ = nullptr;
+};
+
+// Object + control block living in an `Arena`: the object is destroyed as usual,
+// the block itself is never `delete`d.
+template <typename T>
+class ControlBlockArena : public ControlBlockObj<T> {
+public:
+    template <typename... Args>
+    ControlBlockArena(Args&&... args) : ControlBlockObj<T>(std::forward<Args>(args)...) {
+    }
+
+    void Deallocate() override {
+        this->~ControlBlockArena();
+        Arena::Forget(this);
+    }
+};
+
+// Deleter policy for `RefCounted` types created by `MakeIntrusiveIn`.
+struct ArenaDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            object->~T();
+        }
+        Arena::Forget(object);
+    }
+};
+
+template <typename Derived>
+using SimpleArenaRefCounted = RefCounted<Derived, SimpleCounter, ArenaDelete>;
+
+template <typename T, typename... Args>
+SharedPtr<T> MakeSharedIn(Arena& arena, Args&&... args) {
+    return SharedPtr<T>(
+        static_cast<ControlBlockObj<T>*>(arena.Create<ControlBlockArena<T>>(std::forward<Args>(args)...)));
+}
+
+// Whether `T` derives from `RefCounted<T, Counter, ArenaDelete>` for some `Counter`.
+template <typename T>
+struct UsesArenaDelete {
+    template <typename Counter>
+    static std::true_type Check(const RefCounted<T, Counter, ArenaDelete>*);
+    static std::false_type Check(...);
+
+    static constexpr bool value = decltype(Check(static_cast<T*>(nullptr)))::value;
+};
+
+// `T` must use `ArenaDelete` as its `RefCounted` deleter (see `SimpleArenaRefCounted`).
+template <typename T, typename... Args>
+IntrusivePtr<T> MakeIntrusiveIn(Arena& arena, Args&&... args) {
+    static_assert(UsesArenaDelete<T>::value, "T would be deleted with a deleter that does not know the arena");
+    return IntrusivePtr<T>(arena.Create<T>(std::forward<Args>(args)...));
+}
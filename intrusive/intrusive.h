@@ -1,7 +1,10 @@
 #pragma once
 
-#include <cstddef>  // for std::nullptr_t
-#include <utility>  // for std::exchange / std::swap
+#include "../profile/refcount_profiler.h"
+
+#include <cstddef>      // for std::nullptr_t
+#include <type_traits>  // for std::void_t
+#include <utility>      // for std::exchange / std::swap
 
 class SimpleCounter {
 public:
@@ -18,10 +21,29 @@ public:
         return count_;
     }
 
+    // Immortality is a sentinel count, so it costs no extra space.
+    void MarkImmortal() {
+        count_ = kImmortal;
+    }
+    bool IsImmortal() const {
+        return count_ == kImmortal;
+    }
+
 private:
+    static constexpr size_t kImmortal = static_cast<size_t>(-1);
+
     size_t count_;
 };
 
+// Counters may provide `MarkImmortal()`/`IsImmortal()`; without them objects cannot be
+// made immortal.
+template <typename Counter, typename = void>
+inline constexpr bool kHasImmortalHook = false;
+
+template <typename Counter>
+inline constexpr bool kHasImmortalHook<Counter, std::void_t<decltype(std::declval<const Counter&>().IsImmortal())>> =
+    true;
+
 struct DefaultDelete {
     template <typename T>
     static void Destroy(T* object) {
@@ -32,6 +54,9 @@ struct DefaultDelete {
 template <typename Derived, typename Counter, typename Deleter = DefaultDelete>
 class RefCounted {
 public:
+    // `RefCount()` of an immortal object.
+    static constexpr size_t kImmortal = static_cast<size_t>(-1);
+
     RefCounted() : counter_() {
     }
     ~RefCounted() {
@@ -63,19 +88,40 @@ public:
 
     // Increase reference counter.
     void IncRef() {
+        if (IsImmortal()) {
+            return;
+        }
+        SMART_PTRS_PROFILE_REFCOUNT(this, Derived);
         counter_.IncRef();
     }
 
     // Decrease reference counter.
     // Destroy object using Deleter when the last instance dies.
     void DecRef() {
+        if (IsImmortal()) {
+            return;
+        }
+        SMART_PTRS_PROFILE_REFCOUNT(this, Derived);
         if (counter_.DecRef() == 0) {
             Deleter().Destroy(static_cast<Derived*>(this));
         }
     }
     // Get current counter value (the number of strong references).
     size_t RefCount() const {
-        return counter_.RefCount();
+        return IsImmortal() ? kImmortal : counter_.RefCount();
+    }
+
+    // Stop counting: the object is never destroyed from now on.
+    void MarkImmortal() {
+        static_assert(kHasImmortalHook<Counter>, "the counter has no immortal state");
+        counter_.MarkImmortal();
+    }
+    bool IsImmortal() const {
+        if constexpr (kHasImmortalHook<Counter>) {
+            return counter_.IsImmortal();
+        } else {
+            return false;
+        }
     }
 
 private:
@@ -85,6 +131,8 @@ private:
 template <typename Derived, typename D = DefaultDelete>
 using SimpleRefCounted = RefCounted<Derived, SimpleCounter, D>;
 
+static_assert(sizeof(SimpleRefCounted<void>) == sizeof(SimpleCounter), "RefCounted must add nothing to its counter");
+
 template <typename T>
 class IntrusivePtr {
 public:
@@ -94,14 +142,16 @@ public:
 
     IntrusivePtr(std::nullptr_t) : ptr_(nullptr) {
     }
-    IntrusivePtr(T* ptr) : ptr_(ptr) {
+    SMART_PTRS_PROFILE_NOINLINE IntrusivePtr(T* ptr) : ptr_(ptr) {
+        SMART_PTRS_PROFILE_SITE();
         if (ptr_) {
             ptr_->IncRef();
         }
     }
 
     template <typename Y>
-    IntrusivePtr(const IntrusivePtr<Y>& other) : ptr_(other.ptr_) {
+    SMART_PTRS_PROFILE_NOINLINE IntrusivePtr(const IntrusivePtr<Y>& other) : ptr_(other.ptr_) {
+        SMART_PTRS_PROFILE_SITE();
         if (ptr_) {
             ptr_->IncRef();
         }
@@ -110,7 +160,8 @@ public:
     IntrusivePtr(IntrusivePtr<Y>&& other) noexcept : ptr_(std::move(other.ptr_)) {
         other.ptr_ = nullptr;
     }
-    IntrusivePtr(const IntrusivePtr& other) : ptr_(other.ptr_) {
+    SMART_PTRS_PROFILE_NOINLINE IntrusivePtr(const IntrusivePtr& other) : ptr_(other.ptr_) {
+        SMART_PTRS_PROFILE_SITE();
         if (ptr_) {
             ptr_->IncRef();
         }
@@ -120,7 +171,8 @@ public:
     }
 
     // `operator=`-s
-    IntrusivePtr& operator=(const IntrusivePtr& other) {
+    SMART_PTRS_PROFILE_NOINLINE IntrusivePtr& operator=(const IntrusivePtr& other) {
+        SMART_PTRS_PROFILE_SITE();
         if (ptr_ != other.ptr_) {
             if (ptr_) {
                 ptr_->DecRef();
@@ -132,7 +184,8 @@ public:
         }
         return *this;
     }
-    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
+    SMART_PTRS_PROFILE_NOINLINE IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
+        SMART_PTRS_PROFILE_SITE();
         if (ptr_ != other.ptr_) {
             if (ptr_) {
                 ptr_->DecRef();
@@ -144,18 +197,21 @@ public:
     }
 
     // Destructor
-    ~IntrusivePtr() {
+    SMART_PTRS_PROFILE_NOINLINE ~IntrusivePtr() {
+        SMART_PTRS_PROFILE_SITE();
         Reset();
     }
 
     // Modifiers
-    void Reset() {
+    SMART_PTRS_PROFILE_NOINLINE void Reset() {
+        SMART_PTRS_PROFILE_SITE();
         if (ptr_) {
             ptr_->DecRef();
         }
         ptr_ = nullptr;
     }
-    void Reset(T* ptr) {
+    SMART_PTRS_PROFILE_NOINLINE void Reset(T* ptr) {
+        SMART_PTRS_PROFILE_SITE();
         if (ptr_) {
             ptr_->DecRef();
         }
@@ -195,3 +251,10 @@ template <typename T, typename... Args>
 IntrusivePtr<T> MakeIntrusive(Args&&... args) {
     return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
 }
+
+template <typename T, typename... Args>
+IntrusivePtr<T> MakeIntrusiveImmortal(Args&&... args) {
+    auto object = new T(std::forward<Args>(args)...);
+    object->MarkImmortal();
+    return IntrusivePtr<T>(object);
+}
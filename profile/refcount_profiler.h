@@ -0,0 +1,218 @@
+#pragma once
+
+// Sampling profiler for reference-count operations, enabled with -DSMART_PTRS_PROFILE.
+// Without the define `SMART_PTRS_PROFILE_REFCOUNT`, `SMART_PTRS_PROFILE_SITE` and
+// `SMART_PTRS_PROFILE_NOINLINE` expand to nothing.
+//
+// Every N-th counter operation on a thread is recorded together with the counted object,
+// its type and its call site. Public `SharedPtr`/`WeakPtr`/`IntrusivePtr` operations open
+// a `SiteScope` with their return address, and the outermost scope on the thread names
+// the site of every counter operation under it, including those run by the destructors
+// it triggers. Those operations are marked `SMART_PTRS_PROFILE_NOINLINE` so that the
+// return address is the call site itself. Operations outside any scope fall back to the
+// caller of the counter method. A sampled operation
+// coming from another thread than the previous sample on the same object counts as a
+// cross-thread handoff - a proxy for cache-line ping-pong on the counter.
+//
+// Statistics are keyed by address, so an object freed and reallocated at the same
+// address is merged with its predecessor.
+
+#ifdef SMART_PTRS_PROFILE
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>  // std::free
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SMART_PTRS_CALL_SITE() __builtin_return_address(0)
+#define SMART_PTRS_PROFILE_NOINLINE __attribute__((noinline))
+#else
+#define SMART_PTRS_CALL_SITE() nullptr
+#define SMART_PTRS_PROFILE_NOINLINE
+#endif
+
+#define SMART_PTRS_PROFILE_REFCOUNT(object, type)                                                 \
+    do {                                                                                          \
+        if (RefCountProfiler::ShouldSample()) {                                                   \
+            auto smart_ptrs_site = RefCountProfiler::CurrentSite();                               \
+            RefCountProfiler::Record((object), typeid(type),                                      \
+                                     smart_ptrs_site ? smart_ptrs_site : SMART_PTRS_CALL_SITE()); \
+        }                                                                                         \
+    } while (false)
+
+#define SMART_PTRS_PROFILE_SITE() RefCountProfiler::SiteScope smart_ptrs_site_scope(SMART_PTRS_CALL_SITE())
+
+class RefCountProfiler {
+public:
+    static constexpr size_t kDefaultSampleRate = 1024;
+
+    struct Entry {
+        const void* object;
+        std::string type;
+        size_t samples;
+        size_t handoffs;
+        // Sampled values scaled by the sample rate.
+        size_t estimated_operations;
+        size_t estimated_handoffs;
+        // Most frequent call sites, most frequent first.
+        std::vector<std::pair<const void*, size_t>> sites;
+    };
+
+    // Attributes the counter operations of the thread to `site` while alive, unless an
+    // outer scope already did.
+    class SiteScope {
+    public:
+        explicit SiteScope(const void* site) : outermost_(!CurrentSite()) {
+            if (outermost_) {
+                CurrentSite() = site;
+            }
+        }
+        SiteScope(const SiteScope&) = delete;
+        SiteScope& operator=(const SiteScope&) = delete;
+        ~SiteScope() {
+            if (outermost_) {
+                CurrentSite() = nullptr;
+            }
+        }
+
+    private:
+        bool outermost_;
+    };
+
+    static const void*& CurrentSite() {
+        thread_local const void* site = nullptr;
+        return site;
+    }
+
+    // Record one of every `rate` operations per thread.
+    static void SetSampleRate(size_t rate) {
+        SampleRate().store(rate ? rate : 1, std::memory_order_relaxed);
+    }
+
+    static bool ShouldSample() {
+        thread_local size_t countdown = SampleRate().load(std::memory_order_relaxed);
+        if (--countdown != 0) {
+            return false;
+        }
+        countdown = SampleRate().load(std::memory_order_relaxed);
+        return true;
+    }
+
+    static void Record(const void* object, const std::type_info& type, const void* site) {
+        auto& state = GetState();
+        auto thread = std::this_thread::get_id();
+        std::lock_guard lock(state.mutex);
+        auto& stats = state.objects[object];
+        stats.type = &type;
+        ++stats.samples;
+        if (stats.samples > 1 && stats.last_thread != thread) {
+            ++stats.handoffs;
+        }
+        stats.last_thread = thread;
+        ++stats.sites[site];
+    }
+
+    // The `k` objects with the most estimated handoffs.
+    static std::vector<Entry> TopK(size_t k, size_t sites_per_entry = 3) {
+        auto& state = GetState();
+        auto rate = SampleRate().load(std::memory_order_relaxed);
+        std::vector<Entry> result;
+        {
+            std::lock_guard lock(state.mutex);
+            for (auto& [object, stats] : state.objects) {
+                std::vector<std::pair<const void*, size_t>> sites(stats.sites.begin(), stats.sites.end());
+                std::sort(sites.begin(), sites.end(),
+                          [](const auto& a, const auto& b) { return a.second > b.second; });
+                sites.resize(std::min(sites.size(), sites_per_entry));
+                result.push_back({object, Demangle(*stats.type), stats.samples, stats.handoffs,
+                                  stats.samples * rate, stats.handoffs * rate, std::move(sites)});
+            }
+        }
+        std::sort(result.begin(), result.end(), [](const Entry& a, const Entry& b) {
+            return a.handoffs != b.handoffs ? a.handoffs > b.handoffs : a.samples > b.samples;
+        });
+        result.resize(std::min(result.size(), k));
+        return result;
+    }
+
+    static void Report(std::ostream& out, size_t k = 10) {
+        for (const auto& entry : TopK(k)) {
+            out << entry.object << ' ' << entry.type << ": ~" << entry.estimated_operations << " ops, ~"
+                << entry.estimated_handoffs << " cross-thread handoffs\n";
+            for (const auto& [site, count] : entry.sites) {
+                out << "    " << site << " x" << count << '\n';
+            }
+        }
+    }
+
+    static void Clear() {
+        auto& state = GetState();
+        std::lock_guard lock(state.mutex);
+        state.objects.clear();
+    }
+
+private:
+    struct Stats {
+        const std::type_info* type = nullptr;
+        size_t samples = 0;
+        size_t handoffs = 0;
+        std::thread::id last_thread;
+        std::unordered_map<const void*, size_t> sites;
+    };
+
+    struct State {
+        std::mutex mutex;
+        std::unordered_map<const void*, Stats> objects;
+    };
+
+    // Never destroyed: pointers in globals still count while static destructors run.
+    static State& GetState() {
+        static auto state = new State();
+        return *state;
+    }
+
+    static std::atomic<size_t>& SampleRate() {
+        static std::atomic<size_t> rate{kDefaultSampleRate};
+        return rate;
+    }
+
+    static std::string Demangle(const std::type_info& type) {
+#if __has_include(<cxxabi.h>)
+        int status = 0;
+        char* name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+        if (status == 0 && name) {
+            std::string result(name);
+            std::free(name);
+            return result;
+        }
+#endif
+        return type.name();
+    }
+};
+
+#else
+
+#define SMART_PTRS_PROFILE_REFCOUNT(object, type) \
+    do {                                          \
+    } while (false)
+
+#define SMART_PTRS_PROFILE_SITE() \
+    do {                          \
+    } while (false)
+
+#define SMART_PTRS_PROFILE_NOINLINE
+
+#endif
@@ -0,0 +1,459 @@
+#pragma once
+
+#include "../shared_and_weak/shared.h"
+#include "../shared_and_weak/weak.h"
+#include "../intrusive/intrusive.h"
+
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Serialization of object graphs linked with `SharedPtr`/`WeakPtr`/`IntrusivePtr`.
+//
+// Every control block (or intrusive object) is written once; further references are
+// back-references by id. Nodes are written breadth-first from a queue, so neither side
+// recurses along the graph, and the writer streams straight into `std::ostream`.
+//
+// User types provide two functions found by ADL:
+//
+//   void Serialize(GraphWriter& writer, const T& value);
+//   void Deserialize(GraphReader& reader, T& value);
+//
+// which must visit the same fields in the same order. Trivially copyable nodes need no
+// hooks and are written as raw bytes. Objects are rebuilt with
+// `MakeShared<T>()`/`MakeIntrusive<T>()`, so node types have to be default-constructible.
+// A node is written with the static type of the first pointer that refers to it directly
+// (not through the aliasing constructor); polymorphic nodes are not supported.
+// Aliasing pointers must point inside the object owned by their control block, and be
+// written after some pointer that refers to that object directly: the reader has to
+// allocate the object before it can resolve them. `Write` throws `BadGraph` otherwise.
+//
+// A stream may be written in chunks, each closed by `Finish()`, and read back with the
+// same calls. Ids stay valid across chunks: a node written earlier is referred to by id
+// and not written again. To keep ids unambiguous, both sides hold every control block
+// they have seen (a weak reference; intrusive objects are held strongly) until they are
+// destroyed. A node that the reader's side has dropped in the meantime cannot be
+// referred to strongly again (`BadGraph`).
+
+class BadGraph : public std::exception {};
+
+enum class GraphTag : uint8_t {
+    kNull,
+    kShared,     // id
+    kAlias,      // id, offset inside the owned object
+    kWeak,       // id, offset inside the owned object
+    kIntrusive,  // id
+};
+
+class GraphWriter {
+public:
+    explicit GraphWriter(std::ostream& out) : out_(out) {
+    }
+    GraphWriter(const GraphWriter&) = delete;
+    GraphWriter& operator=(const GraphWriter&) = delete;
+
+    ~GraphWriter() {
+        for (auto& [key, node] : nodes_) {
+            node.release();
+        }
+    }
+
+    template <typename T>
+    void Write(const SharedPtr<T>& ptr) {
+        if (!ptr.control_block_ || !ptr.ptr_) {
+            WriteTag(GraphTag::kNull);
+            return;
+        }
+        auto offset = OffsetInside(ptr.ptr_, ptr.control_block_);
+        auto& node = Lookup(ptr.control_block_);
+        if (offset == 0) {
+            WriteTag(GraphTag::kShared);
+            WriteVarint(node.id);
+            Schedule(node, ptr.ptr_);
+        } else {
+            if (!node.scheduled) {
+                throw BadGraph();
+            }
+            WriteTag(GraphTag::kAlias);
+            WriteVarint(node.id);
+            WriteVarint(offset);
+        }
+    }
+
+    template <typename T>
+    void Write(const WeakPtr<T>& ptr) {
+        if (ptr.Expired() || !ptr.ptr_) {
+            WriteTag(GraphTag::kNull);
+            return;
+        }
+        auto offset = OffsetInside(ptr.ptr_, ptr.control_block_);
+        auto& node = Lookup(ptr.control_block_);
+        if (!node.scheduled && offset != 0) {
+            throw BadGraph();
+        }
+        WriteTag(GraphTag::kWeak);
+        WriteVarint(node.id);
+        WriteVarint(offset);
+        Schedule(node, ptr.ptr_);
+    }
+
+    template <typename T>
+    void Write(const IntrusivePtr<T>& ptr) {
+        if (!ptr) {
+            WriteTag(GraphTag::kNull);
+            return;
+        }
+        auto& node = Lookup(ptr.Get());
+        WriteTag(GraphTag::kIntrusive);
+        WriteVarint(node.id);
+        Schedule(node, ptr.Get());
+    }
+
+    template <typename T>
+    void WriteValue(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "use Write for pointers, a custom hook otherwise");
+        out_.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    void WriteString(const std::string& value) {
+        WriteVarint(value.size());
+        out_.write(value.data(), value.size());
+    }
+
+    // Write every node reachable from the pointers written so far, closing the chunk.
+    void Finish() {
+        while (!pending_.empty()) {
+            auto body = std::move(pending_.front());
+            pending_.pop_front();
+            body();
+        }
+        out_.flush();
+        if (!out_) {
+            throw BadGraph();
+        }
+    }
+
+private:
+    struct Node {
+        uint64_t id = 0;
+        bool scheduled = false;
+        // Drops the reference that keeps the key from being reused by another node.
+        std::function<void()> release;
+    };
+
+    Node& Lookup(ControlBlock* control_block) {
+        auto [it, inserted] = nodes_.try_emplace(control_block);
+        if (inserted) {
+            it->second.id = nodes_.size() - 1;
+            control_block->IncrementWeakCount();
+            it->second.release = [control_block] { control_block->DecrementWeakCount(); };
+        }
+        return it->second;
+    }
+    template <typename T>
+    Node& Lookup(T* object) {
+        auto [it, inserted] = nodes_.try_emplace(object);
+        if (inserted) {
+            it->second.id = nodes_.size() - 1;
+            object->IncRef();
+            it->second.release = [object] { object->DecRef(); };
+        }
+        return it->second;
+    }
+
+    // Offset of `object` inside the object owned by `control_block`.
+    template <typename T>
+    static uint64_t OffsetInside(const T* object, ControlBlock* control_block) {
+        auto base = reinterpret_cast<uintptr_t>(control_block->GetObject());
+        auto address = reinterpret_cast<uintptr_t>(object);
+        if (address < base || address - base + sizeof(T) > control_block->GetObjectSize()) {
+            throw BadGraph();
+        }
+        return address - base;
+    }
+
+    template <typename T>
+    void Schedule(Node& node, const T* object) {
+        if (node.scheduled) {
+            return;
+        }
+        node.scheduled = true;
+        pending_.emplace_back([this, id = node.id, object] {
+            WriteVarint(id);
+            if constexpr (std::is_trivially_copyable_v<T>) {
+                WriteValue(*object);
+            } else {
+                Serialize(*this, *object);
+            }
+        });
+    }
+
+    void WriteTag(GraphTag tag) {
+        out_.put(static_cast<char>(tag));
+    }
+    void WriteVarint(uint64_t value) {
+        while (value >= 0x80) {
+            out_.put(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out_.put(static_cast<char>(value));
+    }
+    std::ostream& out_;
+    std::unordered_map<const void*, Node> nodes_;
+    std::deque<std::function<void()>> pending_;
+};
+
+class GraphReader {
+public:
+    explicit GraphReader(std::istream& in) : in_(in) {
+    }
+    GraphReader(const GraphReader&) = delete;
+    GraphReader& operator=(const GraphReader&) = delete;
+
+    ~GraphReader() {
+        for (auto& node : nodes_) {
+            if (node.holds_object) {
+                node.control_block->DecrementSharedCount();
+            }
+            if (node.control_block) {
+                node.control_block->DecrementWeakCount();
+            }
+            if (node.release) {
+                node.release();
+            }
+        }
+    }
+
+    template <typename T>
+    void Read(SharedPtr<T>& ptr) {
+        ptr.Reset();
+        switch (ReadTag()) {
+            case GraphTag::kNull:
+                return;
+            case GraphTag::kShared: {
+                auto id = ReadId();
+                if (!nodes_[id].object) {
+                    Materialize<T>(id);
+                }
+                ptr = Share<T>(id, 0);
+                return;
+            }
+            case GraphTag::kAlias: {
+                auto id = ReadId();
+                auto offset = ReadVarint();
+                if (!nodes_[id].object) {
+                    throw BadGraph();
+                }
+                ptr = Share<T>(id, offset);
+                return;
+            }
+            default:
+                throw BadGraph();
+        }
+    }
+
+    // A weak edge to a node that no strong edge reaches is expired after `Finish()`:
+    // nothing keeps that object alive once the reader drops its reference.
+    template <typename T>
+    void Read(WeakPtr<T>& ptr) {
+        ptr.Reset();
+        switch (ReadTag()) {
+            case GraphTag::kNull:
+                return;
+            case GraphTag::kWeak: {
+                auto id = ReadId();
+                auto offset = ReadVarint();
+                if (!nodes_[id].object) {
+                    if (offset != 0) {
+                        throw BadGraph();
+                    }
+                    Materialize<T>(id);
+                }
+                auto& node = Shared(id, offset, sizeof(T));
+                ptr.control_block_ = node.control_block;
+                ptr.ptr_ = reinterpret_cast<T*>(node.object + offset);
+                ptr.IncreaseCount();
+                return;
+            }
+            default:
+                throw BadGraph();
+        }
+    }
+
+    template <typename T>
+    void Read(IntrusivePtr<T>& ptr) {
+        ptr.Reset();
+        switch (ReadTag()) {
+            case GraphTag::kNull:
+                return;
+            case GraphTag::kIntrusive: {
+                auto id = ReadId();
+                auto& node = nodes_[id];
+                if (!node.object) {
+                    auto object = MakeIntrusive<std::remove_const_t<T>>();
+                    auto raw = object.Get();
+                    raw->IncRef();
+                    node.object = reinterpret_cast<char*>(raw);
+                    node.release = [raw] { raw->DecRef(); };
+                    pending_.emplace_back(id, [this, raw] { ReadNode(*raw); });
+                } else if (!node.release) {
+                    throw BadGraph();
+                }
+                ptr = IntrusivePtr<T>(reinterpret_cast<T*>(node.object));
+                return;
+            }
+            default:
+                throw BadGraph();
+        }
+    }
+
+    template <typename T>
+    void ReadValue(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>, "use Read for pointers, a custom hook otherwise");
+        if (!in_.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+            throw BadGraph();
+        }
+    }
+    void ReadString(std::string& value) {
+        value.resize(ReadVarint());
+        if (!in_.read(value.data(), value.size())) {
+            throw BadGraph();
+        }
+    }
+
+    // Read every node reachable from the pointers read so far, closing the chunk. The
+    // objects read are from now on owned only by the pointers that refer to them.
+    void Finish() {
+        while (!pending_.empty()) {
+            auto [id, body] = std::move(pending_.front());
+            pending_.pop_front();
+            if (ReadVarint() != id) {
+                throw BadGraph();
+            }
+            body();
+        }
+        for (auto& node : nodes_) {
+            if (node.holds_object) {
+                node.holds_object = false;
+                node.control_block->DecrementSharedCount();
+            }
+        }
+    }
+
+private:
+    struct Node {
+        // Set for `SharedPtr` nodes; the reader keeps a weak reference to it.
+        ControlBlock* control_block = nullptr;
+        char* object = nullptr;
+        // The reader holds a strong reference while the chunk is incomplete.
+        bool holds_object = false;
+        // Set for intrusive nodes: drops the reader's reference.
+        std::function<void()> release;
+    };
+
+    // `SharedPtr` node `id` with a live object that has room for `size` bytes at `offset`.
+    Node& Shared(uint64_t id, uint64_t offset, size_t size) {
+        auto& node = nodes_[id];
+        if (!node.control_block || offset > node.control_block->GetObjectSize() ||
+            size > node.control_block->GetObjectSize() - offset) {
+            throw BadGraph();
+        }
+        return node;
+    }
+
+    template <typename T>
+    SharedPtr<T> Share(uint64_t id, uint64_t offset) {
+        auto& node = Shared(id, offset, sizeof(T));
+        if (node.control_block->GetSharedCount() == 0) {
+            // Dropped on this side since an earlier chunk.
+            throw BadGraph();
+        }
+        SharedPtr<T> result;
+        result.control_block_ = node.control_block;
+        result.ptr_ = reinterpret_cast<T*>(node.object + offset);
+        result.IncreaseCount();
+        return result;
+    }
+
+    template <typename T>
+    void Materialize(uint64_t id) {
+        auto object = MakeShared<std::remove_const_t<T>>();
+        auto raw = object.Get();
+        auto control_block = object.control_block_;
+        control_block->IncrementSharedCount();
+        control_block->IncrementWeakCount();
+        nodes_[id].control_block = control_block;
+        nodes_[id].object = reinterpret_cast<char*>(raw);
+        nodes_[id].holds_object = true;
+        pending_.emplace_back(id, [this, raw] { ReadNode(*raw); });
+    }
+
+    template <typename T>
+    void ReadNode(T& object) {
+        if constexpr (std::is_trivially_copyable_v<T>) {
+            ReadValue(object);
+        } else {
+            Deserialize(*this, object);
+        }
+    }
+
+    GraphTag ReadTag() {
+        auto tag = in_.get();
+        if (tag == std::istream::traits_type::eof() || tag > static_cast<int>(GraphTag::kIntrusive)) {
+            throw BadGraph();
+        }
+        return static_cast<GraphTag>(tag);
+    }
+    // Ids are handed out in order of first appearance.
+    uint64_t ReadId() {
+        auto id = ReadVarint();
+        if (id > nodes_.size()) {
+            throw BadGraph();
+        }
+        if (id == nodes_.size()) {
+            nodes_.emplace_back();
+        }
+        return id;
+    }
+    uint64_t ReadVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            auto byte = in_.get();
+            if (byte == std::istream::traits_type::eof()) {
+                throw BadGraph();
+            }
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw BadGraph();
+    }
+
+    std::istream& in_;
+    std::vector<Node> nodes_;
+    std::deque<std::pair<uint64_t, std::function<void()>>> pending_;
+};
+
+template <typename T>
+void SerializeGraph(std::ostream& out, const SharedPtr<T>& root) {
+    GraphWriter writer(out);
+    writer.Write(root);
+    writer.Finish();
+}
+
+template <typename T>
+SharedPtr<T> DeserializeGraph(std::istream& in) {
+    GraphReader reader(in);
+    SharedPtr<T> root;
+    reader.Read(root);
+    reader.Finish();
+    return root;
+}
@@ -44,15 +44,17 @@ public:
     }
 
     template <typename Y>
-    SharedPtr(Y* ptr) : control_block_(new ControlBlockPtr<Y>(ptr)), ptr_(ptr) {
+    SMART_PTRS_PROFILE_NOINLINE SharedPtr(Y* ptr) : control_block_(new ControlBlockPtr<Y>(ptr)), ptr_(ptr) {
+        SMART_PTRS_PROFILE_SITE();
         if constexpr (std::is_convertible_v<Y*, EnableSharedFromThisBase*>) {
             if (control_block_) {
                 InitWeakThis(ptr);
             }
         }
     }
-    SharedPtr(ControlBlockObj<T>* control_block)
+    SMART_PTRS_PROFILE_NOINLINE SharedPtr(ControlBlockObj<T>* control_block)
         : control_block_(control_block), ptr_(control_block->Get()) {
+        SMART_PTRS_PROFILE_SITE();
         if constexpr (std::is_convertible_v<T*, EnableSharedFromThisBase*>) {
             if (control_block_) {
                 InitWeakThis(ptr_);
@@ -61,7 +63,9 @@ public:
     }
 
     template <typename Y>
+    SMART_PTRS_PROFILE_NOINLINE
     SharedPtr(const SharedPtr<Y>& other) : control_block_(other.control_block_), ptr_(other.ptr_) {
+        SMART_PTRS_PROFILE_SITE();
         IncreaseCount();
     }
     template <typename Y>
@@ -70,7 +74,9 @@ public:
         other.control_block_ = nullptr;
         other.ptr_ = nullptr;
     }
+    SMART_PTRS_PROFILE_NOINLINE
     SharedPtr(const SharedPtr& other) : control_block_(other.control_block_), ptr_(other.ptr_) {
+        SMART_PTRS_PROFILE_SITE();
         IncreaseCount();
     }
 
@@ -82,13 +88,16 @@ public:
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
+    SMART_PTRS_PROFILE_NOINLINE
     SharedPtr(const SharedPtr<Y>& other, T* ptr) : control_block_(other.control_block_), ptr_(ptr) {
+        SMART_PTRS_PROFILE_SITE();
         IncreaseCount();
     }
 
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other) {
+    SMART_PTRS_PROFILE_NOINLINE explicit SharedPtr(const WeakPtr<T>& other) {
+        SMART_PTRS_PROFILE_SITE();
         if (other.Expired()) {
             throw BadWeakPtr();
         }
@@ -103,14 +112,16 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
 
-    SharedPtr& operator=(const SharedPtr& other) {
+    SMART_PTRS_PROFILE_NOINLINE SharedPtr& operator=(const SharedPtr& other) {
+        SMART_PTRS_PROFILE_SITE();
         DecreaseCount();
         control_block_ = other.control_block_;
         ptr_ = other.ptr_;
         IncreaseCount();
         return *this;
     }
-    SharedPtr& operator=(SharedPtr&& other) noexcept {
+    SMART_PTRS_PROFILE_NOINLINE SharedPtr& operator=(SharedPtr&& other) noexcept {
+        SMART_PTRS_PROFILE_SITE();
         DecreaseCount();
         control_block_ = std::move(other.control_block_);
         ptr_ = std::move(other.ptr_);
@@ -122,7 +133,8 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Destructor
 
-    ~SharedPtr() {
+    SMART_PTRS_PROFILE_NOINLINE ~SharedPtr() {
+        SMART_PTRS_PROFILE_SITE();
         Reset();
     }
 
@@ -138,13 +150,15 @@ public:
             control_block_->DecrementSharedCount();
         }
     }
-    void Reset() {
+    SMART_PTRS_PROFILE_NOINLINE void Reset() {
+        SMART_PTRS_PROFILE_SITE();
         DecreaseCount();
         control_block_ = nullptr;
         ptr_ = nullptr;
     }
     template <typename Y>
-    void Reset(Y* ptr) {
+    SMART_PTRS_PROFILE_NOINLINE void Reset(Y* ptr) {
+        SMART_PTRS_PROFILE_SITE();
         DecreaseCount();
         control_block_ = new ControlBlockPtr<Y>(ptr);
         ptr_ = ptr;
@@ -181,6 +195,12 @@ private:
 
     template <typename Y>
     friend class WeakPtr;
+
+    template <typename Y>
+    friend class SharedPtrArray;
+
+    friend class GraphWriter;
+    friend class GraphReader;
 };
 
 template <typename T, typename U>
@@ -193,3 +213,12 @@ template <typename T, typename... Args>
 SharedPtr<T> MakeShared(Args&&... args) {
     return SharedPtr(new ControlBlockObj<T>(std::forward<Args>(args)...));
 }
+
+// Process-lifetime object: copies and destruction of its pointers never touch the counters,
+// `UseCount()` reports `ControlBlock::kImmortal`, and the object is never destroyed.
+template <typename T, typename... Args>
+SharedPtr<T> MakeSharedImmortal(Args&&... args) {
+    auto control_block = new ControlBlockObj<T>(std::forward<Args>(args)...);
+    control_block->MarkImmortal();
+    return SharedPtr(control_block);
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "shared.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Collection of `SharedPtr<T>` stored as two parallel arrays: object pointers and control
+// blocks. Scans over the objects read only the first array, and `Clear()` releases the
+// control blocks sorted by address, one call per distinct block.
+template <typename T>
+class SharedPtrArray {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    SharedPtrArray() = default;
+    SharedPtrArray(const SharedPtrArray& other) : objects_(other.objects_), blocks_(other.blocks_) {
+        for (auto block : blocks_) {
+            if (block) {
+                block->IncrementSharedCount();
+            }
+        }
+    }
+    SharedPtrArray(SharedPtrArray&& other) noexcept
+        : objects_(std::move(other.objects_)), blocks_(std::move(other.blocks_)) {
+        other.objects_.clear();
+        other.blocks_.clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+    SharedPtrArray& operator=(const SharedPtrArray& other) {
+        SharedPtrArray tmp(other);
+        Swap(tmp);
+        return *this;
+    }
+    SharedPtrArray& operator=(SharedPtrArray&& other) noexcept {
+        SharedPtrArray tmp(std::move(other));
+        Swap(tmp);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+    ~SharedPtrArray() {
+        Clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+    void PushBack(const SharedPtr<T>& ptr) {
+        Grow();
+        objects_.push_back(ptr.ptr_);
+        blocks_.push_back(ptr.control_block_);
+        if (ptr.control_block_) {
+            ptr.control_block_->IncrementSharedCount();
+        }
+    }
+    void PushBack(SharedPtr<T>&& ptr) {
+        Grow();
+        objects_.push_back(ptr.ptr_);
+        blocks_.push_back(ptr.control_block_);
+        ptr.control_block_ = nullptr;
+        ptr.ptr_ = nullptr;
+    }
+    void PopBack() {
+        auto block = blocks_.back();
+        objects_.pop_back();
+        blocks_.pop_back();
+        if (block) {
+            block->DecrementSharedCount();
+        }
+    }
+    void Reserve(size_t size) {
+        objects_.reserve(size);
+        blocks_.reserve(size);
+    }
+    // Release everything, grouping references to the same control block.
+    void Clear() {
+        // Detach first: destructors of the released objects may touch this array.
+        auto blocks = std::move(blocks_);
+        blocks_.clear();
+        objects_.clear();
+
+        std::sort(blocks.begin(), blocks.end());
+        for (size_t begin = 0, end = 0; begin < blocks.size(); begin = end) {
+            while (end < blocks.size() && blocks[end] == blocks[begin]) {
+                ++end;
+            }
+            if (blocks[begin]) {
+                blocks[begin]->DecrementSharedCount(end - begin);
+            }
+        }
+    }
+    void Swap(SharedPtrArray& other) {
+        std::swap(objects_, other.objects_);
+        std::swap(blocks_, other.blocks_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+    SharedPtr<T> operator[](size_t pos) const {
+        SharedPtr<T> result;
+        result.control_block_ = blocks_[pos];
+        result.ptr_ = objects_[pos];
+        result.IncreaseCount();
+        return result;
+    }
+    // Borrowed pointer, valid while the array holds it.
+    T* GetRaw(size_t pos) const {
+        return objects_[pos];
+    }
+    size_t Size() const {
+        return objects_.size();
+    }
+    bool Empty() const {
+        return objects_.empty();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Scans
+
+    // Call `func(T&)` for every non-null object, prefetching objects a few steps ahead.
+    template <typename Func>
+    void ForEach(Func&& func) const {
+        for (size_t i = 0; i < objects_.size(); ++i) {
+            if (i + kPrefetchDistance < objects_.size()) {
+                Prefetch(objects_[i + kPrefetchDistance]);
+            }
+            if (objects_[i]) {
+                func(*objects_[i]);
+            }
+        }
+    }
+    // Branch-free, so the compiler can vectorize it.
+    size_t CountNull() const {
+        size_t count = 0;
+        for (auto object : objects_) {
+            count += object == nullptr;
+        }
+        return count;
+    }
+    // Distinct objects owned by nobody but this array, i.e. those `Clear()` would destroy:
+    // a block qualifies when all its references are entries of the array.
+    size_t CountUnique() const {
+        auto blocks = blocks_;
+        std::sort(blocks.begin(), blocks.end());
+        size_t count = 0;
+        for (size_t begin = 0, end = 0; begin < blocks.size(); begin = end) {
+            while (end < blocks.size() && blocks[end] == blocks[begin]) {
+                ++end;
+            }
+            count += blocks[begin] && blocks[begin]->GetSharedCount() == end - begin;
+        }
+        return count;
+    }
+
+private:
+    static constexpr size_t kPrefetchDistance = 8;
+
+    // Make room in both arrays before touching either, so a failed allocation cannot
+    // leave them out of step.
+    void Grow() {
+        if (objects_.size() == objects_.capacity() || blocks_.size() == blocks_.capacity()) {
+            Reserve(2 * objects_.size() + 1);
+        }
+    }
+
+    static void Prefetch([[maybe_unused]] const void* ptr) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(ptr);
+#endif
+    }
+
+    std::vector<T*> objects_;
+    std::vector<ControlBlock*> blocks_;
+};
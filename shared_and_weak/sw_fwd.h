@@ -1,5 +1,9 @@
 #pragma once
 
+#include "../profile/refcount_profiler.h"
+#include "../unique/compressed_tuple.h"
+#include "../unique/unique.h"  // DefaultDeleter
+
 #include <exception>
 #include <array>
 
@@ -13,31 +17,75 @@ class WeakPtr;
 
 class ControlBlock {
 public:
+    // Shared count of an immortal block. Such a block is never released, so none of the
+    // counter operations below write to it.
+    static constexpr size_t kImmortal = static_cast<size_t>(-1);
+
     ControlBlock() : shared_count_(1), weak_count_(0) {
     }
     virtual ~ControlBlock() = default;
 
     void IncrementSharedCount() {
+        if (IsImmortal()) {
+            return;
+        }
+        SMART_PTRS_PROFILE_REFCOUNT(this, *this);
         ++shared_count_;
     }
     void DecrementSharedCount() {
+        if (IsImmortal()) {
+            return;
+        }
+        SMART_PTRS_PROFILE_REFCOUNT(this, *this);
         if (shared_count_ == 1) {
             Deleter();
         }
         --shared_count_;
         if (shared_count_ == 0 && weak_count_ == 0) {
-            delete this;
+            Deallocate();
+        }
+    }
+    // Release `count` references at once.
+    void DecrementSharedCount(size_t count) {
+        if (IsImmortal()) {
+            return;
         }
+        shared_count_ -= count - 1;
+        DecrementSharedCount();
     }
     void IncrementWeakCount() {
+        if (IsImmortal()) {
+            return;
+        }
+        SMART_PTRS_PROFILE_REFCOUNT(this, *this);
         ++weak_count_;
     }
     void DecrementWeakCount() {
+        if (IsImmortal()) {
+            return;
+        }
+        SMART_PTRS_PROFILE_REFCOUNT(this, *this);
         if (--weak_count_ == 0 && shared_count_ == 0) {
-            delete this;
+            Deallocate();
         }
     }
     virtual void Deleter() = 0;
+    // Address of the owned object, whatever pointer type the owners see it through.
+    virtual void* GetObject() = 0;
+    // Size of that object as it was created.
+    virtual size_t GetObjectSize() const = 0;
+    // Called once both counters drop to zero. Blocks that do not own their memory
+    // (e.g. arena-allocated ones) override this to skip `delete`.
+    virtual void Deallocate() {
+        delete this;
+    }
+
+    void MarkImmortal() {
+        shared_count_ = kImmortal;
+    }
+    bool IsImmortal() const {
+        return shared_count_ == kImmortal;
+    }
 
     size_t GetSharedCount() const {
         return shared_count_;
@@ -62,6 +110,12 @@ public:
     void Deleter() override {
         Get()->~T();
     }
+    void* GetObject() override {
+        return Get();
+    }
+    size_t GetObjectSize() const override {
+        return sizeof(T);
+    }
     T* Get() {
         return reinterpret_cast<T*>(&object_);
     }
@@ -70,21 +124,32 @@ private:
     alignas(T) std::array<char, sizeof(T)> object_;
 };
 
-template <typename T>
+template <typename T, typename D = DefaultDeleter<T>>
 class ControlBlockPtr : public ControlBlock {
 public:
     ~ControlBlockPtr() override = default;
-    ControlBlockPtr(T* ptr) : ptr_(ptr) {
+    ControlBlockPtr(T* ptr) : ptr_(ptr, D()) {
+    }
+    ControlBlockPtr(T* ptr, D deleter) : ptr_(ptr, std::move(deleter)) {
     }
 
     void Deleter() override {
-        delete ptr_;
+        ptr_.template Get<1>()(Get());
+    }
+    void* GetObject() override {
+        return Get();
+    }
+    size_t GetObjectSize() const override {
+        return sizeof(T);
     }
 
     T* Get() {
-        return ptr_;
+        return ptr_.template Get<0>();
     }
 
 private:
-    T* ptr_;
-};
\ No newline at end of file
+    CompressedTuple<T*, D> ptr_;
+};
+
+// An empty deleter adds nothing to the block.
+static_assert(sizeof(ControlBlockPtr<int>) == sizeof(ControlBlock) + sizeof(int*));
\ No newline at end of file
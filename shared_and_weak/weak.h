@@ -11,10 +11,14 @@ public:
     }
 
     template <typename Y>
+    SMART_PTRS_PROFILE_NOINLINE
     WeakPtr(const WeakPtr<Y>& other) : control_block_(other.control_block_), ptr_(other.ptr_) {
+        SMART_PTRS_PROFILE_SITE();
         IncreaseCount();
     }
+    SMART_PTRS_PROFILE_NOINLINE
     WeakPtr(const WeakPtr& other) : control_block_(other.control_block_), ptr_(other.ptr_) {
+        SMART_PTRS_PROFILE_SITE();
         IncreaseCount();
     }
     template <typename Y>
@@ -30,13 +34,16 @@ public:
     }
     // Demote `SharedPtr`
     // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
+    SMART_PTRS_PROFILE_NOINLINE
     WeakPtr(const SharedPtr<T>& other) : control_block_(other.control_block_), ptr_(other.ptr_) {
+        SMART_PTRS_PROFILE_SITE();
         IncreaseCount();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
-    WeakPtr& operator=(const WeakPtr& other) {
+    SMART_PTRS_PROFILE_NOINLINE WeakPtr& operator=(const WeakPtr& other) {
+        SMART_PTRS_PROFILE_SITE();
         DecreaseCount();
         control_block_ = other.control_block_;
         ptr_ = other.ptr_;
@@ -44,7 +51,8 @@ public:
         return *this;
     }
 
-    WeakPtr& operator=(WeakPtr&& other) noexcept {
+    SMART_PTRS_PROFILE_NOINLINE WeakPtr& operator=(WeakPtr&& other) noexcept {
+        SMART_PTRS_PROFILE_SITE();
         DecreaseCount();
         control_block_ = std::move(other.control_block_);
         ptr_ = std::move(other.ptr_);
@@ -56,7 +64,8 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Destructor
 
-    ~WeakPtr() {
+    SMART_PTRS_PROFILE_NOINLINE ~WeakPtr() {
+        SMART_PTRS_PROFILE_SITE();
         Reset();
     }
 
@@ -72,7 +81,8 @@ public:
             control_block_->DecrementWeakCount();
         }
     }
-    void Reset() {
+    SMART_PTRS_PROFILE_NOINLINE void Reset() {
+        SMART_PTRS_PROFILE_SITE();
         DecreaseCount();
         control_block_ = nullptr;
     }
@@ -90,7 +100,8 @@ public:
     bool Expired() const {
         return !UseCount();
     }
-    SharedPtr<T> Lock() const {
+    SMART_PTRS_PROFILE_NOINLINE SharedPtr<T> Lock() const {
+        SMART_PTRS_PROFILE_SITE();
         if (control_block_ && UseCount() != 0) {
             return SharedPtr<T>(*this);
         }
@@ -106,4 +117,7 @@ private:
 
     template <typename Y>
     friend class SharedPtr;
+
+    friend class GraphWriter;
+    friend class GraphReader;
 };
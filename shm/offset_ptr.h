@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>  // std::nullptr_t, std::ptrdiff_t
+
+// Pointer stored as the distance from itself to the pointee, so it stays valid when the
+// memory holding both is mapped at different addresses (e.g. shared memory in several
+// processes). Only meaningful when the pointer and the pointee live in the same mapping.
+template <typename T>
+class OffsetPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    OffsetPtr() : offset_(kNull) {
+    }
+    OffsetPtr(std::nullptr_t) : offset_(kNull) {
+    }
+    OffsetPtr(T* ptr) {
+        Set(ptr);
+    }
+    OffsetPtr(const OffsetPtr& other) {
+        Set(other.Get());
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+    OffsetPtr& operator=(const OffsetPtr& other) {
+        Set(other.Get());
+        return *this;
+    }
+    OffsetPtr& operator=(T* ptr) {
+        Set(ptr);
+        return *this;
+    }
+    OffsetPtr& operator=(std::nullptr_t) {
+        offset_ = kNull;
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+    T* Get() const {
+        if (offset_ == kNull) {
+            return nullptr;
+        }
+        return reinterpret_cast<T*>(reinterpret_cast<char*>(const_cast<OffsetPtr*>(this)) + offset_);
+    }
+    T& operator*() const {
+        return *Get();
+    }
+    T* operator->() const {
+        return Get();
+    }
+    explicit operator bool() const {
+        return offset_ != kNull;
+    }
+
+private:
+    // 0 would be a pointer to itself, which is legal; 1 never is for an aligned `OffsetPtr`.
+    static constexpr std::ptrdiff_t kNull = 1;
+
+    void Set(T* ptr) {
+        if (ptr) {
+            offset_ = reinterpret_cast<const char*>(ptr) - reinterpret_cast<const char*>(this);
+        } else {
+            offset_ = kNull;
+        }
+    }
+
+    std::ptrdiff_t offset_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const OffsetPtr<T>& left, const OffsetPtr<U>& right) {
+    return left.Get() == right.Get();
+}
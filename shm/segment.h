@@ -0,0 +1,512 @@
+#pragma once
+
+#include "offset_ptr.h"
+
+#include <atomic>
+#include <bitset>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Reference counting across processes through a POSIX shared memory segment.
+//
+// Every attached process owns one bit in the holder mask of each object it references;
+// the mask lives next to the object in the segment and is updated atomically. Copies of
+// `SegmentPtr` inside one process are counted locally, like `SharedPtr` (not
+// thread-safe). The object is freed when the last process lets go, and
+// `Segment::RecoverDeadProcesses()` drops the bits of processes that died without
+// letting go.
+//
+// Objects must be trivially destructible (nobody can run a destructor for a crashed
+// process) and position-independent: link them with `OffsetPtr`, not raw pointers.
+//
+// After `fork()` the child must attach with its own `Segment`; handles inherited from
+// the parent become inert in the child and never touch the parent's bits.
+
+class BadSegment : public std::exception {};
+
+template <typename T>
+class SegmentPtr;
+
+class Segment {
+public:
+    static constexpr size_t kMaxProcesses = 63;
+    static constexpr size_t kMaxRoots = 16;
+
+    // Create a new segment of `size` bytes (fails if `name` already exists). Throws
+    // `BadSegment` if `size` cannot even hold the segment header.
+    Segment(const std::string& name, size_t size) : pid_(getpid()) {
+        if (size < kFirstBlock) {
+            throw BadSegment();
+        }
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "shm_open");
+        }
+        if (ftruncate(fd, size) != 0) {
+            int error = errno;
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::system_error(error, std::generic_category(), "ftruncate");
+        }
+        Map(fd, size);
+        auto header = new (base_) Header();
+        header->size = size;
+        header->bump = kFirstBlock;
+        header->magic.store(kMagic, std::memory_order_release);
+        Attach();
+    }
+
+    // Open an existing segment.
+    explicit Segment(const std::string& name) : pid_(getpid()) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "shm_open");
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "fstat");
+        }
+        Map(fd, info.st_size);
+        if (size_ < kFirstBlock || GetHeader()->magic.load(std::memory_order_acquire) != kMagic) {
+            munmap(base_, size_);
+            throw BadSegment();
+        }
+        Attach();
+    }
+
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    // All `SegmentPtr`s of this segment must be gone by now.
+    ~Segment() {
+        if (getpid() == pid_) {
+            assert(refs_.empty());
+            GetHeader()->processes[slot_].store(0, std::memory_order_release);
+        }
+        munmap(base_, size_);
+    }
+
+    static void Unlink(const std::string& name) {
+        shm_unlink(name.c_str());
+    }
+
+    // Make `ptr` reachable from other processes through `Find(root)`. The segment itself
+    // then holds the object until every root naming it is unpublished or republished.
+    // Roots are numbered below `kMaxRoots`, other numbers throw `std::out_of_range`.
+    template <typename T>
+    void Publish(size_t root, const SegmentPtr<T>& ptr) {
+        CheckRoot(root);
+        SetRoot(root, ptr ? ptr.ref_->offset : 0);
+    }
+    void Unpublish(size_t root) {
+        CheckRoot(root);
+        SetRoot(root, 0);
+    }
+    // Empty if nothing is published under `root`.
+    template <typename T>
+    SegmentPtr<T> Find(size_t root) {
+        CheckRoot(root);
+        Lock();
+        auto offset = GetHeader()->roots[root].load(std::memory_order_acquire);
+        auto it = offset ? refs_.find(offset) : refs_.end();
+        // A published object keeps the segment bit, so it cannot be freed under the lock.
+        bool fresh = offset && it == refs_.end();
+        if (fresh) {
+            GetBlock(offset)->holders.fetch_or(uint64_t(1) << slot_, std::memory_order_acq_rel);
+        }
+        Unlock();
+        if (fresh) {
+            return SegmentPtr<T>(Adopt(offset));
+        }
+        if (offset) {
+            ++it->second->count;
+            return SegmentPtr<T>(it->second);
+        }
+        return SegmentPtr<T>();
+    }
+
+    // Release everything held by processes that no longer exist. Returns how many such
+    // processes were found. A reused pid is indistinguishable from the original process.
+    size_t RecoverDeadProcesses() {
+        size_t recovered = 0;
+        auto header = GetHeader();
+        for (size_t slot = 0; slot < kMaxProcesses; ++slot) {
+            auto pid = header->processes[slot].load(std::memory_order_acquire);
+            if (pid == 0 || IsAlive(pid)) {
+                continue;
+            }
+            Lock();
+            // Someone else may have recovered the slot (and a new process taken it) since
+            // the check above.
+            if (header->processes[slot].load(std::memory_order_acquire) != pid) {
+                Unlock();
+                continue;
+            }
+            uint64_t bit = uint64_t(1) << slot;
+            for (auto offset = kFirstBlock; offset < header->bump;) {
+                auto block = GetBlock(offset);
+                auto next = offset + block->size;
+                if (block->used) {
+                    auto prev = block->holders.fetch_and(~bit, std::memory_order_acq_rel);
+                    if (prev == bit) {
+                        FreeLocked(offset);
+                    }
+                }
+                offset = next;
+            }
+            // Freed under the lock, so the recheck above never sees a recovered slot.
+            header->processes[slot].store(0, std::memory_order_release);
+            Unlock();
+            ++recovered;
+        }
+        return recovered;
+    }
+
+    // Bytes never handed out yet (freed blocks are not counted).
+    size_t Available() const {
+        return size_ - GetHeader()->bump;
+    }
+
+private:
+    static constexpr uint64_t kMagic = 0x534d415254534d31;  // "SMARTSM1"
+    static constexpr uint64_t kSegmentBit = uint64_t(1) << kMaxProcesses;
+    static constexpr size_t kAlignment = 16;
+
+    struct Header {
+        std::atomic<uint64_t> magic{0};
+        uint64_t size = 0;
+        // Allocator state, guarded by `lock` (pid of the holder, 0 when free).
+        std::atomic<pid_t> lock{0};
+        uint64_t free_list = 0;
+        uint64_t bump = 0;
+        std::atomic<pid_t> processes[kMaxProcesses] = {};
+        std::atomic<uint64_t> roots[kMaxRoots] = {};
+    };
+
+    struct Block {
+        uint64_t size;  // including this header
+        uint64_t next;  // next free block, while free
+        std::atomic<uint64_t> holders;
+        uint32_t used;
+        uint32_t roots;  // roots naming the object, guarded by `lock`
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<pid_t>::is_always_lock_free,
+                  "atomics in shared memory must be address-free");
+
+    static constexpr uint64_t kFirstBlock = (sizeof(Header) + 63) / 64 * 64;
+    static constexpr uint64_t kBlockHeader = (sizeof(Block) + kAlignment - 1) / kAlignment * kAlignment;
+
+    // Process-local record of one object referenced from this process.
+    struct SegmentRef {
+        Segment* segment;
+        uint64_t offset;
+        size_t count;
+        pid_t pid;
+    };
+
+    void Map(int fd, size_t size) {
+        void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int error = errno;
+        close(fd);
+        if (base == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), "mmap");
+        }
+        base_ = static_cast<char*>(base);
+        size_ = size;
+    }
+
+    void Attach() {
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            for (size_t slot = 0; slot < kMaxProcesses; ++slot) {
+                pid_t expected = 0;
+                if (GetHeader()->processes[slot].compare_exchange_strong(expected, pid_,
+                                                                         std::memory_order_acq_rel)) {
+                    slot_ = slot;
+                    return;
+                }
+            }
+            RecoverDeadProcesses();
+        }
+        munmap(base_, size_);
+        throw BadSegment();
+    }
+
+    static void CheckRoot(size_t root) {
+        if (root >= kMaxRoots) {
+            throw std::out_of_range("Segment root");
+        }
+    }
+
+    static bool IsAlive(pid_t pid) {
+        return kill(pid, 0) == 0 || errno != ESRCH;
+    }
+
+    Header* GetHeader() const {
+        return reinterpret_cast<Header*>(base_);
+    }
+    Block* GetBlock(uint64_t offset) const {
+        return reinterpret_cast<Block*>(base_ + offset);
+    }
+    void* GetObject(uint64_t offset) const {
+        return base_ + offset + kBlockHeader;
+    }
+
+    void Lock() {
+        auto& lock = GetHeader()->lock;
+        pid_t holder = 0;
+        while (!lock.compare_exchange_weak(holder, pid_, std::memory_order_acquire)) {
+            // The holder crashed inside the allocator: take over.
+            if (holder != 0 && !IsAlive(holder) &&
+                lock.compare_exchange_strong(holder, pid_, std::memory_order_acquire)) {
+                return;
+            }
+            holder = 0;
+            sched_yield();
+        }
+    }
+    void Unlock() {
+        GetHeader()->lock.store(0, std::memory_order_release);
+    }
+
+    uint64_t AllocateBlock(size_t size) {
+        uint64_t need = (kBlockHeader + size + kAlignment - 1) / kAlignment * kAlignment;
+        auto header = GetHeader();
+        Lock();
+        uint64_t* link = &header->free_list;
+        while (*link) {
+            auto offset = *link;
+            auto block = GetBlock(offset);
+            if (block->size >= need) {
+                if (block->size - need >= 2 * kBlockHeader) {
+                    auto rest = GetBlock(offset + need);
+                    rest->size = block->size - need;
+                    rest->next = block->next;
+                    rest->used = 0;
+                    rest->roots = 0;
+                    rest->holders.store(0, std::memory_order_relaxed);
+                    block->size = need;
+                    *link = offset + need;
+                } else {
+                    *link = block->next;
+                }
+                block->used = 1;
+                Unlock();
+                return offset;
+            }
+            link = &block->next;
+        }
+        if (header->bump + need > size_) {
+            Unlock();
+            throw std::bad_alloc();
+        }
+        auto offset = header->bump;
+        header->bump += need;
+        auto block = new (GetBlock(offset)) Block();
+        block->size = need;
+        block->used = 1;
+        Unlock();
+        return offset;
+    }
+
+    void FreeLocked(uint64_t offset) {
+        auto block = GetBlock(offset);
+        block->used = 0;
+        block->next = GetHeader()->free_list;
+        GetHeader()->free_list = offset;
+    }
+
+    // Clear `bit` in the holder mask; the last holder frees the block.
+    void Drop(uint64_t offset, uint64_t bit) {
+        if (GetBlock(offset)->holders.fetch_and(~bit, std::memory_order_acq_rel) == bit) {
+            Lock();
+            FreeLocked(offset);
+            Unlock();
+        }
+    }
+    void DropLocked(uint64_t offset, uint64_t bit) {
+        if (GetBlock(offset)->holders.fetch_and(~bit, std::memory_order_acq_rel) == bit) {
+            FreeLocked(offset);
+        }
+    }
+
+    // The segment bit is set while at least one root names the object.
+    void SetRoot(size_t root, uint64_t offset) {
+        Lock();
+        auto old = GetHeader()->roots[root].load(std::memory_order_relaxed);
+        if (old != offset) {
+            if (offset && GetBlock(offset)->roots++ == 0) {
+                GetBlock(offset)->holders.fetch_or(kSegmentBit, std::memory_order_acq_rel);
+            }
+            GetHeader()->roots[root].store(offset, std::memory_order_release);
+            if (old && --GetBlock(old)->roots == 0) {
+                DropLocked(old, kSegmentBit);
+            }
+        }
+        Unlock();
+    }
+
+    // Record a reference to a block whose bit this process has just set. The bit is
+    // dropped again if that fails.
+    SegmentRef* Adopt(uint64_t offset) {
+        SegmentRef* ref = nullptr;
+        try {
+            ref = new SegmentRef{this, offset, 1, pid_};
+            refs_.emplace(offset, ref);
+        } catch (...) {
+            delete ref;
+            Drop(offset, uint64_t(1) << slot_);
+            throw;
+        }
+        return ref;
+    }
+
+    static void Release(SegmentRef* ref) {
+        if (--ref->count != 0) {
+            return;
+        }
+        // Inherited through fork: the bit belongs to the parent.
+        if (getpid() == ref->pid) {
+            auto segment = ref->segment;
+            segment->refs_.erase(ref->offset);
+            segment->Drop(ref->offset, uint64_t(1) << segment->slot_);
+        }
+        delete ref;
+    }
+
+    template <typename T, typename... Args>
+    friend SegmentPtr<T> MakeSharedInSegment(Segment& segment, Args&&... args);
+
+    template <typename T>
+    friend class SegmentPtr;
+
+    char* base_ = nullptr;
+    size_t size_ = 0;
+    size_t slot_ = 0;
+    pid_t pid_;
+    std::unordered_map<uint64_t, SegmentRef*> refs_;
+};
+
+template <typename T>
+class SegmentPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    SegmentPtr() : ref_(nullptr), ptr_(nullptr) {
+    }
+    SegmentPtr(std::nullptr_t) : ref_(nullptr), ptr_(nullptr) {
+    }
+    SegmentPtr(const SegmentPtr& other) : ref_(other.ref_), ptr_(other.ptr_) {
+        if (ref_) {
+            ++ref_->count;
+        }
+    }
+    SegmentPtr(SegmentPtr&& other) noexcept
+        : ref_(std::exchange(other.ref_, nullptr)), ptr_(std::exchange(other.ptr_, nullptr)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+    SegmentPtr& operator=(const SegmentPtr& other) {
+        SegmentPtr tmp(other);
+        Swap(tmp);
+        return *this;
+    }
+    SegmentPtr& operator=(SegmentPtr&& other) noexcept {
+        SegmentPtr tmp(std::move(other));
+        Swap(tmp);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+    ~SegmentPtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+    void Reset() {
+        if (ref_) {
+            Segment::Release(std::exchange(ref_, nullptr));
+        }
+        ptr_ = nullptr;
+    }
+    void Swap(SegmentPtr& other) {
+        std::swap(ref_, other.ref_);
+        std::swap(ptr_, other.ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+    T* Get() const {
+        return ptr_;
+    }
+    T& operator*() const {
+        return *ptr_;
+    }
+    T* operator->() const {
+        return ptr_;
+    }
+    // Handles in this process.
+    size_t UseCount() const {
+        return ref_ ? ref_->count : 0;
+    }
+    // Processes (plus the segment itself, if published) holding the object.
+    size_t ProcessCount() const {
+        return ref_ ? std::bitset<64>(ref_->segment->GetBlock(ref_->offset)->holders.load()).count() : 0;
+    }
+    explicit operator bool() const {
+        return ptr_ != nullptr;
+    }
+
+private:
+    explicit SegmentPtr(Segment::SegmentRef* ref)
+        : ref_(ref), ptr_(ref ? static_cast<T*>(ref->segment->GetObject(ref->offset)) : nullptr) {
+    }
+
+    Segment::SegmentRef* ref_;
+    T* ptr_;
+
+    friend class Segment;
+
+    template <typename Y, typename... Args>
+    friend SegmentPtr<Y> MakeSharedInSegment(Segment& segment, Args&&... args);
+};
+
+template <typename T, typename... Args>
+SegmentPtr<T> MakeSharedInSegment(Segment& segment, Args&&... args) {
+    static_assert(std::is_trivially_destructible_v<T>, "segment objects are never destroyed");
+    static_assert(alignof(T) <= Segment::kAlignment);
+
+    auto offset = segment.AllocateBlock(sizeof(T));
+    try {
+        new (segment.GetObject(offset)) T(std::forward<Args>(args)...);
+    } catch (...) {
+        segment.Lock();
+        segment.FreeLocked(offset);
+        segment.Unlock();
+        throw;
+    }
+    segment.GetBlock(offset)->holders.store(uint64_t(1) << segment.slot_, std::memory_order_release);
+    return SegmentPtr<T>(segment.Adopt(offset));
+}
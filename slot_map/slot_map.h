@@ -0,0 +1,301 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class SlotMap;
+
+// Generational reference into a `SlotMap`: slot index and generation packed in one word.
+// A handle never keeps anything alive; once its object is erased the generation stops
+// matching and every lookup fails. The default handle is always stale.
+template <typename T>
+class Handle {
+public:
+    Handle() : value_(0) {
+    }
+
+    uint32_t Index() const {
+        return static_cast<uint32_t>(value_);
+    }
+    uint32_t Generation() const {
+        return static_cast<uint32_t>(value_ >> 32);
+    }
+    explicit operator bool() const {
+        return value_ != 0;
+    }
+
+private:
+    Handle(uint32_t index, uint32_t generation)
+        : value_((static_cast<uint64_t>(generation) << 32) | index) {
+    }
+
+    uint64_t value_;
+
+    template <typename Y>
+    friend class SlotMap;
+};
+
+template <typename T>
+inline bool operator==(const Handle<T>& left, const Handle<T>& right) {
+    return left.Index() == right.Index() && left.Generation() == right.Generation();
+}
+
+template <typename T>
+inline bool operator!=(const Handle<T>& left, const Handle<T>& right) {
+    return !(left == right);
+}
+
+// Result of `SlotMap::Lock`: while it lives, the object is not destroyed, even if it is
+// erased (its handles go stale immediately, the storage is reclaimed on the last release).
+// It is a borrow, not a pin: the storage is contiguous, so the object still moves when
+// the map grows or another object is removed. Do not keep `Get()` across such calls.
+template <typename T>
+class BorrowedRef {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    BorrowedRef() : map_(nullptr), slot_(0) {
+    }
+    BorrowedRef(BorrowedRef&& other) noexcept
+        : map_(std::exchange(other.map_, nullptr)), slot_(other.slot_) {
+    }
+    BorrowedRef(const BorrowedRef&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+    BorrowedRef& operator=(BorrowedRef&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            map_ = std::exchange(other.map_, nullptr);
+            slot_ = other.slot_;
+        }
+        return *this;
+    }
+    BorrowedRef& operator=(const BorrowedRef&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+    ~BorrowedRef() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+    void Reset() {
+        if (map_) {
+            std::exchange(map_, nullptr)->Unborrow(slot_);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // Resolved on every call: the object may move inside the map while borrowed.
+    T* Get() const {
+        return map_ ? map_->SlotValue(slot_) : nullptr;
+    }
+    T& operator*() const {
+        return *Get();
+    }
+    T* operator->() const {
+        return Get();
+    }
+    explicit operator bool() const {
+        return map_ != nullptr;
+    }
+
+private:
+    BorrowedRef(SlotMap<T>* map, uint32_t slot) : map_(map), slot_(slot) {
+    }
+
+    SlotMap<T>* map_;
+    uint32_t slot_;
+
+    template <typename Y>
+    friend class SlotMap;
+};
+
+// Objects stored contiguously (erase swaps the last object into the hole), addressed by
+// `Handle`s through an indirection table of slots. Lookup is O(1) with a stale check.
+// Erased objects that are still borrowed are parked past `end()` until released, so
+// iteration and `Size()` only ever see live objects.
+//
+// Borrowed references point back to the map, so the map is neither copyable nor movable
+// and must outlive them.
+template <typename T>
+class SlotMap {
+public:
+    using iterator = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    SlotMap() = default;
+    SlotMap(const SlotMap&) = delete;
+    SlotMap& operator=(const SlotMap&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+    template <typename... Args>
+    Handle<T> Emplace(Args&&... args) {
+        values_.emplace_back(std::forward<Args>(args)...);
+        uint32_t slot;
+        if (free_head_ != kNoSlot) {
+            slot = free_head_;
+            free_head_ = slots_[slot].index;
+        } else {
+            slot = static_cast<uint32_t>(slots_.size());
+            slots_.emplace_back();
+        }
+        slots_[slot].index = static_cast<uint32_t>(values_.size() - 1);
+        slot_of_.push_back(slot);
+        // In front of the parked objects.
+        SwapPositions(values_.size() - 1, Size() - 1);
+        return Handle<T>(slot, slots_[slot].generation);
+    }
+    Handle<T> Insert(T value) {
+        return Emplace(std::move(value));
+    }
+
+    // Returns false for a stale handle. A borrowed object is destroyed on its last release.
+    bool Erase(Handle<T> handle) {
+        if (!Contains(handle)) {
+            return false;
+        }
+        auto& slot = slots_[handle.Index()];
+        if (++slot.generation == 0) {
+            slot.generation = 1;
+        }
+        if (slot.borrows != 0) {
+            Park(handle.Index());
+        } else {
+            Remove(handle.Index());
+        }
+        return true;
+    }
+    void Clear() {
+        while (Size() != 0) {
+            auto slot = slot_of_[Size() - 1];
+            if (++slots_[slot].generation == 0) {
+                slots_[slot].generation = 1;
+            }
+            if (slots_[slot].borrows != 0) {
+                Park(slot);
+            } else {
+                Remove(slot);
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+    bool Contains(Handle<T> handle) const {
+        return handle.Index() < slots_.size() && !slots_[handle.Index()].erased &&
+               slots_[handle.Index()].generation == handle.Generation();
+    }
+    T* Get(Handle<T> handle) {
+        return Contains(handle) ? &values_[slots_[handle.Index()].index] : nullptr;
+    }
+    const T* Get(Handle<T> handle) const {
+        return Contains(handle) ? &values_[slots_[handle.Index()].index] : nullptr;
+    }
+    // `WeakPtr::Lock` analogue: empty for a stale handle.
+    BorrowedRef<T> Lock(Handle<T> handle) {
+        if (!Contains(handle)) {
+            return BorrowedRef<T>();
+        }
+        ++slots_[handle.Index()].borrows;
+        return BorrowedRef<T>(this, handle.Index());
+    }
+    // Handle of the object at position `pos` of the dense storage.
+    Handle<T> HandleAt(size_t pos) const {
+        auto slot = slot_of_[pos];
+        return Handle<T>(slot, slots_[slot].generation);
+    }
+    size_t Size() const {
+        return values_.size() - erased_;
+    }
+    bool Empty() const {
+        return Size() == 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Dense iteration over the live objects.
+    iterator begin() {
+        return values_.begin();
+    }
+    iterator end() {
+        return values_.begin() + Size();
+    }
+    const_iterator begin() const {
+        return values_.begin();
+    }
+    const_iterator end() const {
+        return values_.begin() + Size();
+    }
+
+private:
+    static constexpr uint32_t kNoSlot = static_cast<uint32_t>(-1);
+
+    struct Slot {
+        // Position in `values_` while occupied, next free slot otherwise.
+        uint32_t index = kNoSlot;
+        uint32_t generation = 1;
+        uint32_t borrows = 0;
+        bool erased = false;
+    };
+
+    T* SlotValue(uint32_t slot) {
+        return &values_[slots_[slot].index];
+    }
+
+    void Unborrow(uint32_t slot) {
+        if (--slots_[slot].borrows == 0 && slots_[slot].erased) {
+            --erased_;
+            Remove(slot);
+        }
+    }
+
+    void SwapPositions(size_t left, size_t right) {
+        if (left == right) {
+            return;
+        }
+        using std::swap;
+        swap(values_[left], values_[right]);
+        swap(slot_of_[left], slot_of_[right]);
+        slots_[slot_of_[left]].index = static_cast<uint32_t>(left);
+        slots_[slot_of_[right]].index = static_cast<uint32_t>(right);
+    }
+
+    // Move the live object of `slot` past the live range, where it waits for its last
+    // release.
+    void Park(uint32_t slot) {
+        SwapPositions(slots_[slot].index, Size() - 1);
+        slots_[slot].erased = true;
+        ++erased_;
+    }
+
+    // Swap-remove the object of `slot` from the dense storage and free the slot. A live
+    // object is first swapped to the end of the live range, so the parked ones stay
+    // behind it.
+    void Remove(uint32_t slot) {
+        if (!slots_[slot].erased) {
+            SwapPositions(slots_[slot].index, Size() - 1);
+        }
+        SwapPositions(slots_[slot].index, values_.size() - 1);
+        values_.pop_back();
+        slot_of_.pop_back();
+        slots_[slot].erased = false;
+        slots_[slot].index = free_head_;
+        free_head_ = slot;
+    }
+
+    std::vector<T> values_;
+    std::vector<uint32_t> slot_of_;  // position in `values_` -> slot
+    std::vector<Slot> slots_;
+    uint32_t free_head_ = kNoSlot;
+    size_t erased_ = 0;  // erased but still borrowed
+
+    friend class BorrowedRef<T>;
+};
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "../unique/unique.h"
+#include "../shared_and_weak/shared.h"
+#include "../intrusive/intrusive.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Iterative destruction of long ownership chains.
+//
+// Releasing the head of a list built from owning pointers normally recurses once per
+// node. Owners created with the policies below do not destroy the object in place:
+// they push it onto a thread-local stack, and the outermost release pops and destroys
+// objects in a loop. Nested releases triggered by those destructors only push, so the
+// call depth stays constant.
+//
+// With a budget set, one release destroys at most that many objects; the rest stays
+// pending until the next release or an explicit `Teardown::Drain`.
+class Teardown {
+public:
+    static constexpr size_t kUnlimited = static_cast<size_t>(-1);
+
+    using DestroyFn = void (*)(void*);
+
+    static void Schedule(void* object, DestroyFn destroy) {
+        auto& state = GetState();
+        state.pending.push_back({object, destroy});
+        if (!state.draining) {
+            DrainState(state, state.budget);
+        }
+    }
+
+    // Destroy up to `budget` pending objects. Returns the number destroyed.
+    static size_t Drain(size_t budget = kUnlimited) {
+        auto& state = GetState();
+        if (state.draining) {
+            return 0;
+        }
+        return DrainState(state, budget);
+    }
+
+    static size_t Pending() {
+        return GetState().pending.size();
+    }
+
+    // Limit on objects destroyed by one release on this thread.
+    static void SetBudget(size_t budget) {
+        GetState().budget = budget;
+    }
+
+private:
+    struct Task {
+        void* object;
+        DestroyFn destroy;
+    };
+
+    struct State {
+        std::vector<Task> pending;
+        size_t budget = kUnlimited;
+        bool draining = false;
+
+        ~State() {
+            // Nothing may leak at thread exit, whatever the budget.
+            DrainState(*this, kUnlimited);
+        }
+    };
+
+    static State& GetState() {
+        thread_local State state;
+        return state;
+    }
+
+    static size_t DrainState(State& state, size_t budget) {
+        state.draining = true;
+        size_t destroyed = 0;
+        while (destroyed < budget && !state.pending.empty()) {
+            auto task = state.pending.back();
+            state.pending.pop_back();
+            task.destroy(task.object);
+            ++destroyed;
+        }
+        state.draining = false;
+        return destroyed;
+    }
+};
+
+// Deleter for `UniquePtr`.
+template <typename T>
+struct IterativeDeleter {
+    IterativeDeleter() = default;
+    ~IterativeDeleter() = default;
+
+    template <typename S>
+    IterativeDeleter(IterativeDeleter<S>&&){};
+
+    void operator()(T* ptr) {
+        if (ptr) {
+            Teardown::Schedule(ptr, [](void* object) { delete static_cast<T*>(object); });
+        }
+    }
+};
+
+template <typename T>
+struct IterativeDeleter<T[]> {
+    IterativeDeleter() = default;
+    ~IterativeDeleter() = default;
+
+    template <typename S>
+    IterativeDeleter(IterativeDeleter<S>&&){};
+
+    void operator()(T* ptr) {
+        if (ptr) {
+            Teardown::Schedule(ptr, [](void* object) { delete[] static_cast<T*>(object); });
+        }
+    }
+};
+
+// Deleter policy for `RefCounted`.
+struct IterativeDelete {
+    template <typename T>
+    static void Destroy(T* object) {
+        Teardown::Schedule(object, [](void* ptr) { delete static_cast<T*>(ptr); });
+    }
+};
+
+template <typename Derived>
+using SimpleIterativeRefCounted = RefCounted<Derived, SimpleCounter, IterativeDelete>;
+
+// Control block whose object is destroyed through `Teardown`. The block holds an extra
+// weak reference until then, so its storage outlives the pending object.
+template <typename T>
+class ControlBlockIterative : public ControlBlockObj<T> {
+public:
+    template <typename... Args>
+    ControlBlockIterative(Args&&... args) : ControlBlockObj<T>(std::forward<Args>(args)...) {
+    }
+
+    void Deleter() override {
+        this->IncrementWeakCount();
+        Teardown::Schedule(this, [](void* ptr) {
+            auto block = static_cast<ControlBlockIterative*>(ptr);
+            block->ControlBlockObj<T>::Deleter();
+            block->DecrementWeakCount();
+        });
+    }
+};
+
+template <typename T, typename... Args>
+SharedPtr<T> MakeSharedIterative(Args&&... args) {
+    return SharedPtr<T>(
+        static_cast<ControlBlockObj<T>*>(new ControlBlockIterative<T>(std::forward<Args>(args)...)));
+}
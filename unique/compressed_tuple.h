@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// N-ary `CompressedPair`: every empty non-final member is stored as a base (EBO), and
+// members are laid out by decreasing alignment to minimize padding. `Get<I>()` still
+// uses the declaration order.
+
+template <size_t I, typename T, bool = std::is_empty_v<T> && !std::is_final_v<T>>
+class TupleLeaf {
+public:
+    constexpr TupleLeaf() : value_() {
+    }
+    template <typename U>
+    constexpr TupleLeaf(U&& value) : value_(std::forward<U>(value)) {
+    }
+
+    constexpr T& Get() {
+        return value_;
+    }
+    constexpr const T& Get() const {
+        return value_;
+    }
+
+private:
+    T value_;
+};
+
+template <size_t I, typename T>
+class TupleLeaf<I, T, true> : T {
+public:
+    constexpr TupleLeaf() = default;
+    template <typename U>
+    constexpr TupleLeaf(U&& value) : T(std::forward<U>(value)) {
+    }
+
+    constexpr T& Get() {
+        return *this;
+    }
+    constexpr const T& Get() const {
+        return *this;
+    }
+};
+
+// Storage order: empty members first (they take no space), then by decreasing alignment.
+template <typename... Ts>
+struct TupleLayout {
+    static constexpr std::array<size_t, sizeof...(Ts)> kOrder = [] {
+        constexpr bool kEmpty[] = {(std::is_empty_v<Ts> && !std::is_final_v<Ts>)..., false};
+        constexpr size_t kAlign[] = {alignof(Ts)..., 0};
+        std::array<size_t, sizeof...(Ts)> order{};
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        // Stable insertion sort, the arrays are tiny.
+        for (size_t i = 1; i < order.size(); ++i) {
+            for (size_t j = i; j > 0; --j) {
+                auto left = order[j - 1];
+                auto right = order[j];
+                bool less = kEmpty[right] != kEmpty[left] ? kEmpty[right] : kAlign[right] > kAlign[left];
+                if (!less) {
+                    break;
+                }
+                order[j - 1] = right;
+                order[j] = left;
+            }
+        }
+        return order;
+    }();
+
+    template <size_t... Is>
+    static auto MakeSequence(std::index_sequence<Is...>) -> std::index_sequence<kOrder[Is]...>;
+
+    using Sequence = decltype(MakeSequence(std::index_sequence_for<Ts...>()));
+};
+
+template <typename Sequence, typename... Ts>
+class CompressedTupleBase;
+
+template <size_t... Order, typename... Ts>
+class CompressedTupleBase<std::index_sequence<Order...>, Ts...>
+    : TupleLeaf<Order, std::tuple_element_t<Order, std::tuple<Ts...>>>... {
+public:
+    constexpr CompressedTupleBase() = default;
+
+    template <typename Args>
+    constexpr CompressedTupleBase(std::piecewise_construct_t, Args&& args)
+        : TupleLeaf<Order, std::tuple_element_t<Order, std::tuple<Ts...>>>(
+              std::get<Order>(std::forward<Args>(args)))... {
+    }
+
+    template <size_t I>
+    constexpr auto& Get() {
+        return static_cast<TupleLeaf<I, std::tuple_element_t<I, std::tuple<Ts...>>>&>(*this).Get();
+    }
+    template <size_t I>
+    constexpr const auto& Get() const {
+        return static_cast<const TupleLeaf<I, std::tuple_element_t<I, std::tuple<Ts...>>>&>(*this).Get();
+    }
+};
+
+template <typename... Ts>
+class CompressedTuple : public CompressedTupleBase<typename TupleLayout<Ts...>::Sequence, Ts...> {
+    using Base = CompressedTupleBase<typename TupleLayout<Ts...>::Sequence, Ts...>;
+
+public:
+    constexpr CompressedTuple() = default;
+
+    // One argument per member, in declaration order.
+    template <typename... Args,
+              typename = std::enable_if_t<sizeof...(Args) == sizeof...(Ts) &&
+                                          !(sizeof...(Args) == 1 &&
+                                            (std::is_same_v<std::decay_t<Args>, CompressedTuple> || ...))>>
+    constexpr CompressedTuple(Args&&... args)
+        : Base(std::piecewise_construct, std::forward_as_tuple(std::forward<Args>(args)...)) {
+    }
+};
+
+static_assert(sizeof(CompressedTuple<int*, std::tuple<>>) == sizeof(int*));
+static_assert(sizeof(CompressedTuple<std::tuple<>, std::integral_constant<int, 0>, int*>) == sizeof(int*));
+static_assert(sizeof(CompressedTuple<char, int*, char>) == 2 * sizeof(int*));
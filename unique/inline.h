@@ -0,0 +1,197 @@
+#pragma once
+
+#include "compressed_pair.h"
+#include "unique.h"
+
+#include <cassert>
+#include <cstddef>  // std::nullptr_t, std::max_align_t
+#include <cstdint>  // uintptr_t
+#include <new>
+#include <type_traits>
+#include <utility>
+
+inline constexpr size_t kDefaultInlineCapacity = 4 * sizeof(void*);
+
+// Unique owner of a polymorphic object that keeps small derived objects inside itself.
+// Objects that are too big, over-aligned or not nothrow-movable go to the heap with `new`.
+// Heap objects are destroyed with `Deleter`, exactly as in `UniquePtr<Base, Deleter>`, so
+// the paths that allocate with `new` (heap `Emplace` and `Release`) require the default
+// deleter; with a custom one only inline objects and pointers passed in are supported.
+template <typename Base, size_t Capacity = kDefaultInlineCapacity, typename Deleter = DefaultDeleter<Base>>
+class InlinePtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+    explicit InlinePtr(Base* ptr = nullptr) : ptr_(ptr, Deleter()) {
+    }
+    InlinePtr(Base* ptr, const Deleter& deleter) : ptr_(ptr, deleter) {
+    }
+    InlinePtr(Base* ptr, Deleter&& deleter) noexcept : ptr_(ptr, std::move(deleter)) {
+    }
+    InlinePtr(InlinePtr&& other) noexcept : ptr_(nullptr, std::move(other.GetDeleter())) {
+        MoveFrom(other);
+    }
+    InlinePtr(const InlinePtr& other) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+    InlinePtr& operator=(InlinePtr&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            GetDeleter() = std::move(other.GetDeleter());
+            MoveFrom(other);
+        }
+        return *this;
+    }
+    InlinePtr& operator=(std::nullptr_t) {
+        Reset();
+        return *this;
+    }
+    InlinePtr& operator=(const InlinePtr&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+    ~InlinePtr() {
+        Reset();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    // Construct `Derived` in place of the current object.
+    template <typename Derived, typename... Args>
+    Derived* Emplace(Args&&... args) {
+        static_assert(std::is_base_of_v<Base, Derived>);
+        Reset();
+        if constexpr (kFitsInline<Derived>) {
+            auto object = new (&storage_) Derived(std::forward<Args>(args)...);
+            ops_ = &kOps<Derived>;
+            ptr_.GetFirst() = object;
+            return object;
+        } else {
+            static_assert(kDefaultDeleter, "Derived does not fit inline and would be allocated with new");
+            auto object = new Derived(std::forward<Args>(args)...);
+            ptr_.GetFirst() = object;
+            return object;
+        }
+    }
+
+    // An inline object is first moved to the heap with `new`, so the caller can free the
+    // result with `delete` either way.
+    Base* Release() {
+        static_assert(kDefaultDeleter, "an inline object would be released through new");
+        if (ops_) {
+            auto ptr = ops_->move_to_heap(&storage_);
+            ops_ = nullptr;
+            ptr_.GetFirst() = nullptr;
+            return ptr;
+        }
+        return std::exchange(ptr_.GetFirst(), nullptr);
+    }
+    // Like `UniquePtr::Reset`, resetting to the held object is a no-op. Any other `ptr`
+    // must be a heap object, never one living in the inline buffer.
+    void Reset(Base* ptr = nullptr) {
+        if (ptr == Get()) {
+            return;
+        }
+        assert(!PointsIntoStorage(ptr) && "InlinePtr::Reset to an inline object");
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        } else if (Get() != nullptr) {
+            GetDeleter()(std::exchange(ptr_.GetFirst(), nullptr));
+        }
+        ptr_.GetFirst() = ptr;
+    }
+    void Swap(InlinePtr& other) {
+        InlinePtr tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+    Base* Get() const {
+        return ptr_.GetFirst();
+    }
+    Deleter& GetDeleter() {
+        return ptr_.GetSecond();
+    }
+    const Deleter& GetDeleter() const {
+        return ptr_.GetSecond();
+    }
+    bool IsInline() const {
+        return ops_ != nullptr;
+    }
+    explicit operator bool() const {
+        return Get() != nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Single-object dereference operators
+    Base& operator*() const {
+        return *ptr_.GetFirst();
+    }
+    Base* operator->() const {
+        return ptr_.GetFirst();
+    }
+
+private:
+    // Type-erased operations on the inline object.
+    struct Ops {
+        Base* (*move)(void* from, void* to);  // leaves `from` destroyed
+        Base* (*move_to_heap)(void* from);    // leaves `from` destroyed
+        void (*destroy)(void* object);
+    };
+
+    static constexpr bool kDefaultDeleter = std::is_same_v<Deleter, DefaultDeleter<Base>>;
+
+    template <typename Derived>
+    static constexpr bool kFitsInline = sizeof(Derived) <= Capacity &&
+                                        alignof(Derived) <= alignof(std::max_align_t) &&
+                                        std::is_nothrow_move_constructible_v<Derived>;
+
+    template <typename Derived>
+    static constexpr Ops kOps = {
+        [](void* from, void* to) -> Base* {
+            auto object = static_cast<Derived*>(from);
+            auto moved = new (to) Derived(std::move(*object));
+            object->~Derived();
+            return moved;
+        },
+        [](void* from) -> Base* {
+            auto object = static_cast<Derived*>(from);
+            auto moved = new Derived(std::move(*object));
+            object->~Derived();
+            return moved;
+        },
+        [](void* object) { static_cast<Derived*>(object)->~Derived(); },
+    };
+
+    bool PointsIntoStorage(const Base* ptr) const {
+        auto address = reinterpret_cast<uintptr_t>(ptr);
+        auto begin = reinterpret_cast<uintptr_t>(&storage_);
+        return address >= begin && address < begin + Capacity;
+    }
+
+    void MoveFrom(InlinePtr& other) noexcept {
+        if (other.ops_) {
+            ops_ = std::exchange(other.ops_, nullptr);
+            ptr_.GetFirst() = ops_->move(&other.storage_, &storage_);
+            other.ptr_.GetFirst() = nullptr;
+        } else {
+            ptr_.GetFirst() = std::exchange(other.ptr_.GetFirst(), nullptr);
+        }
+    }
+
+    CompressedPair<Base*, Deleter> ptr_;
+    const Ops* ops_ = nullptr;
+    alignas(std::max_align_t) unsigned char storage_[Capacity];
+};
+
+template <typename Base, typename Derived, size_t Capacity = kDefaultInlineCapacity, typename... Args>
+InlinePtr<Base, Capacity> MakeInline(Args&&... args) {
+    InlinePtr<Base, Capacity> result;
+    result.template Emplace<Derived>(std::forward<Args>(args)...);
+    return result;
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "compressed_pair.h"
+#include "compressed_tuple.h"
 
 #include <cstddef>  // std::nullptr_t
 
@@ -31,8 +31,8 @@ public:
     }
     template <typename F, typename S>
     UniquePtr(UniquePtr<F, S>&& other) noexcept {
-        ptr_.GetSecond() = std::move(other.GetDeleter());
-        ptr_.GetFirst() = std::move(other.Release());
+        ptr_.template Get<1>() = std::move(other.GetDeleter());
+        ptr_.template Get<0>() = std::move(other.Release());
     }
     UniquePtr(const UniquePtr& other) = delete;
 
@@ -40,7 +40,7 @@ public:
     // `operator=`-s
     template <typename F, typename S>
     UniquePtr& operator=(UniquePtr<F, S>&& other) noexcept {
-        ptr_.GetSecond() = (std::move(other.GetDeleter()));
+        ptr_.template Get<1>() = (std::move(other.GetDeleter()));
         Reset(other.Release());
         return *this;
     }
@@ -59,8 +59,8 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
     T* Release() {
-        auto tmp = ptr_.GetFirst();
-        ptr_.GetFirst() = nullptr;
+        auto tmp = ptr_.template Get<0>();
+        ptr_.template Get<0>() = nullptr;
         return tmp;
     }
     void Reset(T* ptr = nullptr) {
@@ -68,24 +68,24 @@ public:
             GetDeleter()(Release());
         }
         if (ptr != nullptr) {
-            ptr_.GetFirst() = ptr;
+            ptr_.template Get<0>() = ptr;
         }
     }
     void Swap(UniquePtr& other) {
-        std::swap(ptr_.GetFirst(), other.ptr_.GetFirst());
+        std::swap(ptr_.template Get<0>(), other.ptr_.template Get<0>());
         std::swap(GetDeleter(), other.GetDeleter());
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Observers
     T* Get() const {
-        return ptr_.GetFirst();
+        return ptr_.template Get<0>();
     }
     Deleter& GetDeleter() {
-        return ptr_.GetSecond();
+        return ptr_.template Get<1>();
     }
     const Deleter& GetDeleter() const {
-        return ptr_.GetSecond();
+        return ptr_.template Get<1>();
     }
     explicit operator bool() const {
         return Get() != nullptr;
@@ -94,14 +94,14 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Single-object dereference operators
     T operator*() const {
-        return *ptr_.GetFirst();
+        return *ptr_.template Get<0>();
     }
     T* operator->() const {
-        return ptr_.GetFirst();
+        return ptr_.template Get<0>();
     }
 
 private:
-    CompressedPair<T*, Deleter> ptr_;
+    CompressedTuple<T*, Deleter> ptr_;
 };
 
 // Specialization for arrays
@@ -132,9 +132,9 @@ public:
 
     template <typename F>
     UniquePtr(UniquePtr<F>&& other) noexcept {
-        if (ptr_.GetFirst() != other.Get()) {
-            ptr_.GetSecond() = std::move(other.GetDeleter());
-            ptr_.GetFirst() = std::move(other.Release());
+        if (ptr_.template Get<0>() != other.Get()) {
+            ptr_.template Get<1>() = std::move(other.GetDeleter());
+            ptr_.template Get<0>() = std::move(other.Release());
         }
     }
     UniquePtr(const UniquePtr& other) = delete;
@@ -143,7 +143,7 @@ public:
     // `operator=`-s
     template <typename F>
     UniquePtr& operator=(UniquePtr<F>&& other) noexcept {
-        ptr_.GetSecond() = (std::move(other.GetDeleter()));
+        ptr_.template Get<1>() = (std::move(other.GetDeleter()));
         Reset(other.Release());
         return *this;
     }
@@ -163,7 +163,7 @@ public:
     // Modifiers
     T* Release() {
         auto tmp = Get();
-        ptr_.GetFirst() = nullptr;
+        ptr_.template Get<0>() = nullptr;
         return tmp;
     }
     void Reset(T* ptr = nullptr) {
@@ -171,24 +171,24 @@ public:
             GetDeleter()(Release());
         }
         if (ptr != nullptr) {
-            ptr_.GetFirst() = ptr;
+            ptr_.template Get<0>() = ptr;
         }
     }
     void Swap(UniquePtr& other) {
-        std::swap(ptr_.GetFirst(), other.ptr_.GetFirst());
-        std::swap(ptr_.GetSecond(), other.ptr_.GetSecond());
+        std::swap(ptr_.template Get<0>(), other.ptr_.template Get<0>());
+        std::swap(ptr_.template Get<1>(), other.ptr_.template Get<1>());
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Observers
     T* Get() const {
-        return ptr_.GetFirst();
+        return ptr_.template Get<0>();
     }
     Deleter& GetDeleter() {
-        return ptr_.GetSecond();
+        return ptr_.template Get<1>();
     }
     const Deleter& GetDeleter() const {
-        return ptr_.GetSecond();
+        return ptr_.template Get<1>();
     }
     explicit operator bool() const {
         return Get() != nullptr;
@@ -197,12 +197,16 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Single-object dereference operators
     T& operator[](size_t pos) const {
-        return ptr_.GetFirst()[pos];
+        return ptr_.template Get<0>()[pos];
     }
     T* operator->() const {
-        return ptr_.GetFirst();
+        return ptr_.template Get<0>();
     }
 
 private:
-    CompressedPair<T*, Deleter> ptr_;
+    CompressedTuple<T*, Deleter> ptr_;
 };
+
+// Empty deleters must not cost anything.
+static_assert(sizeof(UniquePtr<int>) == sizeof(int*));
+static_assert(sizeof(UniquePtr<int[]>) == sizeof(int*));